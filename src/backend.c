@@ -0,0 +1,107 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "backend.h"
+
+/* in order of preference */
+static const struct backend *backends[] = {
+#ifdef HAVE_JACK
+    &backend_jack,
+#endif
+#ifdef HAVE_ALSA
+    &backend_alsa,
+#endif
+    &backend_null,
+    NULL
+};
+
+static size_t midi_data_length (unsigned char status) {
+    switch (status & 0xf0) {
+    case 0xc0:
+    case 0xd0:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+uint32_t backend_midi_parse (struct backend_midi_parser *parser,
+                             const unsigned char *bytes,
+                             size_t n) {
+    uint32_t event_count = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char byte = bytes[i];
+
+        if (byte >= 0xf8) {
+            /* real time messages may appear anywhere */
+            continue;
+        } else if (byte >= 0xf0) {
+            /* system messages cancel the running status */
+            parser->status = 0;
+            continue;
+        } else if (byte & 0x80) {
+            parser->status = byte;
+            parser->len = 0;
+            continue;
+        } else if (parser->status == 0) {
+            continue;
+        }
+
+        parser->msg[++parser->len] = byte;
+
+        if (parser->len == midi_data_length (parser->status)) {
+            if (event_count < BACKEND_MAX_MIDI_EVENTS) {
+                unsigned char *data = parser->data[event_count];
+
+                data[0] = parser->status;
+                data[1] = parser->msg[1];
+                data[2] = parser->msg[2];
+
+                parser->events[event_count].time = 0;
+                parser->events[event_count].size = parser->len + 1;
+                parser->events[event_count].buffer = data;
+                ++event_count;
+            }
+            parser->len = 0;
+        }
+    }
+
+    return event_count;
+}
+
+const struct backend *backend_find (const char *name) {
+    if (name == NULL)
+        return backends[0];
+
+    for (int i = 0; backends[i]; i++)
+        if (! strcmp (backends[i]->name, name))
+            return backends[i];
+
+    return NULL;
+}
+
+void backend_print_list (FILE *stream) {
+    for (int i = 0; backends[i]; i++)
+        fprintf (stream, "%s%s", i ? ", " : "", backends[i]->name);
+}
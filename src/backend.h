@@ -0,0 +1,105 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPC_BACKEND_H_
+#define JPC_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BACKEND_MAX_MIDI_EVENTS 256
+
+/* SCHED_FIFO priority of the audio thread of the alsa and null
+   backends. */
+#define BACKEND_RT_PRIORITY 70
+
+/* A midi message, time is the frame offset in the current period. */
+struct backend_midi_event {
+    uint32_t             time;
+    size_t               size;
+    const unsigned char *buffer;
+};
+
+/* Parser of a raw midi byte stream, for the backends reading one. As
+   bytes are read once per period, all the events are at time 0. */
+struct backend_midi_parser {
+    unsigned char status;
+    unsigned char msg[3];
+    size_t        len;
+
+    unsigned char             data[BACKEND_MAX_MIDI_EVENTS][3];
+    struct backend_midi_event events[BACKEND_MAX_MIDI_EVENTS];
+};
+
+/* Called by the backends. process, srate and thread_init run in the audio
+   thread, events are sorted by time. */
+struct backend_callbacks {
+    void (*thread_init) (void *arg);
+    int  (*process)     (uint32_t nframes,
+                         float *out,
+                         const struct backend_midi_event *events,
+                         uint32_t event_count,
+                         void *arg);
+    int  (*srate)       (uint32_t srate, void *arg);
+    void (*shutdown)    (void *arg);
+    void *arg;
+};
+
+/* Settings of the backends driving the clock themselves, a backend
+   ignores what it does not use. */
+struct backend_config {
+    const char *device;
+    const char *midi_device;
+    uint32_t    srate;
+    uint32_t    period;
+    /* real-time mode, the backends running their own audio thread give
+       it BACKEND_RT_PRIORITY */
+    int         realtime;
+};
+
+struct backend {
+    const char *name;
+    int  (*open)  (const struct backend_config *config,
+                   const struct backend_callbacks *callbacks);
+    int  (*start) (void);
+    void (*close) (void);
+};
+
+#ifdef HAVE_JACK
+extern const struct backend backend_jack;
+#endif
+#ifdef HAVE_ALSA
+extern const struct backend backend_alsa;
+#endif
+extern const struct backend backend_null;
+
+/* Parse n bytes into parser->events, returns the number of complete
+   messages. Messages may span several calls. */
+uint32_t backend_midi_parse (struct backend_midi_parser *parser,
+                             const unsigned char *bytes,
+                             size_t n);
+
+/* Find a backend by name, or the default one if name is NULL. */
+const struct backend *backend_find (const char *name);
+
+/* Print the names of the available backends. */
+void backend_print_list (FILE *stream);
+
+#endif
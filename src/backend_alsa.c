@@ -0,0 +1,367 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+    The alsa backend writes directly to a pcm device in mmap mode and
+    reads notes from a rawmidi device, without any sound server.
+*/
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alsa/asoundlib.h>
+
+#include "backend.h"
+#include "rt.h"
+
+static const unsigned int PERIODS = 2;
+
+static const struct backend_callbacks *cb;
+
+static snd_pcm_t *pcm;
+static snd_rawmidi_t *midi_in;
+
+static snd_pcm_format_t format;
+static unsigned int channels;
+static snd_pcm_uframes_t period;
+static int realtime;
+
+static float *buffer;
+
+static pthread_t thread;
+static volatile int running = 0;
+
+static struct backend_midi_parser midi_parser;
+
+#define ALSA_CHECK(_call, _what) do {                                 \
+    int _err = (_call);                                               \
+    if (_err < 0) {                                                   \
+        fprintf (stderr, "Alsa error: %s: %s\n", _what,               \
+                 snd_strerror (_err));                                \
+        return -1;                                                    \
+    }                                                                 \
+} while (0)
+
+static uint32_t read_midi (void) {
+    unsigned char bytes[BACKEND_MAX_MIDI_EVENTS];
+    ssize_t n;
+
+    if (midi_in == NULL)
+        return 0;
+
+    if ((n = snd_rawmidi_read (midi_in, bytes, sizeof (bytes))) <= 0)
+        return 0;
+
+    return backend_midi_parse (&midi_parser, bytes, n);
+}
+
+/* Copy frames of samples into the mmap areas at offset, a NULL samples
+   writes silence. */
+static void write_areas (const snd_pcm_channel_area_t *areas,
+                         snd_pcm_uframes_t offset,
+                         snd_pcm_uframes_t frames,
+                         const float *samples) {
+    for (unsigned int c = 0; c < channels; ++c) {
+        unsigned char *addr = (unsigned char *)areas[c].addr
+            + (areas[c].first + offset * areas[c].step) / 8;
+        unsigned int step = areas[c].step / 8;
+
+        for (snd_pcm_uframes_t i = 0; i < frames; ++i, addr += step) {
+            float sample = samples ? samples[i] : 0.f;
+
+            if (sample > 1.f)
+                sample = 1.f;
+            else if (sample < -1.f)
+                sample = -1.f;
+
+            switch (format) {
+            case SND_PCM_FORMAT_FLOAT:
+                *(float *)addr = sample;
+                break;
+            case SND_PCM_FORMAT_S32:
+                *(int32_t *)addr = sample * 2147483647.0;
+                break;
+            default:
+                *(int16_t *)addr = sample * 32767.f;
+                break;
+            }
+        }
+    }
+}
+
+/* Write frames of samples to the device, or silence if samples is NULL. */
+static int write_period (const float *samples, snd_pcm_uframes_t frames) {
+    while (frames > 0) {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t size = frames;
+        snd_pcm_sframes_t committed;
+        int err;
+
+        if ((err = snd_pcm_mmap_begin (pcm, &areas, &offset, &size)) < 0)
+            return err;
+
+        write_areas (areas, offset, size, samples);
+
+        committed = snd_pcm_mmap_commit (pcm, offset, size);
+        if (committed < 0)
+            return committed;
+        if ((snd_pcm_uframes_t)committed != size)
+            return -EPIPE;
+
+        if (samples)
+            samples += size;
+        frames -= size;
+    }
+
+    return 0;
+}
+
+/* Fill the device buffer with silence and start it. */
+static int start_pcm (void) {
+    snd_pcm_sframes_t avail;
+    int err;
+
+    if ((avail = snd_pcm_avail_update (pcm)) < 0)
+        return avail;
+
+    if ((err = write_period (NULL, avail)) < 0)
+        return err;
+
+    return snd_pcm_start (pcm);
+}
+
+static void *alsa_thread (void *arg) {
+    int err;
+
+    if (realtime)
+        rt_set_priority (BACKEND_RT_PRIORITY);
+    cb->thread_init (cb->arg);
+
+    if ((err = start_pcm ()) < 0) {
+        fprintf (stderr, "Alsa error: cannot start pcm: %s\n",
+                 snd_strerror (err));
+        cb->shutdown (cb->arg);
+        return NULL;
+    }
+
+    while (running) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update (pcm);
+
+        if (avail >= 0 && (snd_pcm_uframes_t)avail < period) {
+            err = snd_pcm_wait (pcm, 1000);
+            if (err >= 0)
+                continue;
+            avail = err;
+        }
+
+        if (avail >= 0) {
+            uint32_t event_count = read_midi ();
+
+            cb->process (period, buffer, midi_parser.events, event_count,
+                         cb->arg);
+            avail = write_period (buffer, period);
+        }
+
+        if (avail < 0) {
+            /* xrun or suspend, restart from silence unless resumed */
+            if ((err = snd_pcm_recover (pcm, avail, 1)) < 0
+                || (snd_pcm_state (pcm) == SND_PCM_STATE_PREPARED
+                    && (err = start_pcm ()) < 0)) {
+                fprintf (stderr, "Alsa error: cannot recover: %s\n",
+                         snd_strerror (err));
+                cb->shutdown (cb->arg);
+                return NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int open_pcm (const struct backend_config *config,
+                     unsigned int *srate) {
+    const snd_pcm_format_t formats[] = {
+        SND_PCM_FORMAT_FLOAT,
+        SND_PCM_FORMAT_S32,
+        SND_PCM_FORMAT_S16
+    };
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_sw_params_t *sw;
+    snd_pcm_access_mask_t *access;
+    snd_pcm_uframes_t buffer_size;
+    unsigned int periods = PERIODS;
+    int dir = 0;
+
+    ALSA_CHECK (snd_pcm_open (&pcm, config->device,
+                              SND_PCM_STREAM_PLAYBACK, 0),
+                config->device);
+
+    snd_pcm_hw_params_alloca (&hw);
+    snd_pcm_access_mask_alloca (&access);
+
+    ALSA_CHECK (snd_pcm_hw_params_any (pcm, hw), "hw params");
+
+    snd_pcm_access_mask_none (access);
+    snd_pcm_access_mask_set (access, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    snd_pcm_access_mask_set (access, SND_PCM_ACCESS_MMAP_NONINTERLEAVED);
+    ALSA_CHECK (snd_pcm_hw_params_set_access_mask (pcm, hw, access),
+                "mmap access");
+
+    format = SND_PCM_FORMAT_UNKNOWN;
+    for (size_t i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i) {
+        if (snd_pcm_hw_params_test_format (pcm, hw, formats[i]) == 0) {
+            format = formats[i];
+            break;
+        }
+    }
+    if (format == SND_PCM_FORMAT_UNKNOWN) {
+        fprintf (stderr, "Alsa error: no supported sample format\n");
+        return -1;
+    }
+    ALSA_CHECK (snd_pcm_hw_params_set_format (pcm, hw, format), "format");
+
+    /* the sound is mono, but many cards only do stereo */
+    channels = 1;
+    ALSA_CHECK (snd_pcm_hw_params_set_channels_near (pcm, hw, &channels),
+                "channels");
+
+    /* dir is also an output, reset it so that the direction of one
+       _near call is not the hint of the next one */
+    *srate = config->srate;
+    dir = 0;
+    ALSA_CHECK (snd_pcm_hw_params_set_rate_near (pcm, hw, srate, &dir),
+                "sample rate");
+
+    period = config->period;
+    dir = 0;
+    ALSA_CHECK (snd_pcm_hw_params_set_period_size_near (pcm, hw,
+                                                        &period, &dir),
+                "period size");
+    dir = 0;
+    ALSA_CHECK (snd_pcm_hw_params_set_periods_near (pcm, hw,
+                                                    &periods, &dir),
+                "periods");
+
+    ALSA_CHECK (snd_pcm_hw_params (pcm, hw), "hw params");
+    ALSA_CHECK (snd_pcm_hw_params_get_period_size (hw, &period, &dir),
+                "period size");
+    ALSA_CHECK (snd_pcm_hw_params_get_buffer_size (hw, &buffer_size),
+                "buffer size");
+
+    snd_pcm_sw_params_alloca (&sw);
+
+    ALSA_CHECK (snd_pcm_sw_params_current (pcm, sw), "sw params");
+    ALSA_CHECK (snd_pcm_sw_params_set_avail_min (pcm, sw, period),
+                "avail min");
+    /* started by hand once the buffer is filled */
+    ALSA_CHECK (snd_pcm_sw_params_set_start_threshold (pcm, sw,
+                                                       buffer_size + 1),
+                "start threshold");
+    ALSA_CHECK (snd_pcm_sw_params (pcm, sw), "sw params");
+
+    return 0;
+}
+
+static void alsa_backend_close (void);
+
+static int alsa_backend_open (const struct backend_config *config,
+                              const struct backend_callbacks *callbacks) {
+    unsigned int srate;
+
+    cb = callbacks;
+    realtime = config->realtime;
+
+    if (open_pcm (config, &srate)) {
+        alsa_backend_close ();
+        return -1;
+    }
+
+    if (config->midi_device
+        && snd_rawmidi_open (&midi_in, NULL, config->midi_device,
+                             SND_RAWMIDI_NONBLOCK) < 0) {
+        fprintf (stderr, "Alsa error: cannot open midi device %s\n",
+                 config->midi_device);
+        alsa_backend_close ();
+        return -1;
+    }
+
+    if ((buffer = calloc (period, sizeof (float))) == NULL) {
+        fprintf (stderr, "Alsa error: cannot allocate buffer\n");
+        alsa_backend_close ();
+        return -1;
+    }
+
+    fprintf (stdout, "Alsa: %s, %u Hz, %u channel(s), %lu frames period\n",
+             snd_pcm_format_name (format), srate, channels,
+             (unsigned long)period);
+
+    cb->srate (srate, cb->arg);
+
+    return 0;
+}
+
+static int alsa_backend_start (void) {
+    int err;
+
+    running = 1;
+    if ((err = pthread_create (&thread, NULL, alsa_thread, NULL))) {
+        fprintf (stderr, "Alsa error: cannot create thread: %s\n",
+                 strerror (err));
+        running = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void alsa_backend_close (void) {
+    if (running) {
+        running = 0;
+        pthread_join (thread, NULL);
+    }
+
+    if (pcm) {
+        snd_pcm_close (pcm);
+        pcm = NULL;
+    }
+
+    if (midi_in) {
+        snd_rawmidi_close (midi_in);
+        midi_in = NULL;
+    }
+
+    free (buffer);
+    buffer = NULL;
+}
+
+#undef ALSA_CHECK
+
+const struct backend backend_alsa = {
+    .name  = "alsa",
+    .open  = alsa_backend_open,
+    .start = alsa_backend_start,
+    .close = alsa_backend_close
+};
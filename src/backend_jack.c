@@ -0,0 +1,117 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+
+#include "backend.h"
+
+static jack_client_t *client;
+
+static jack_port_t *input_port;
+static jack_port_t *output_port;
+
+static const struct backend_callbacks *cb;
+
+static struct backend_midi_event events[BACKEND_MAX_MIDI_EVENTS];
+
+static void thread_init (void *arg) {
+    cb->thread_init (cb->arg);
+}
+
+static int process (jack_nframes_t nframes, void *arg) {
+    void* port_buf = jack_port_get_buffer (input_port, nframes);
+
+    jack_default_audio_sample_t *out = (jack_default_audio_sample_t *)
+        jack_port_get_buffer (output_port, nframes);
+
+    jack_midi_event_t in_event;
+    jack_nframes_t event_count = jack_midi_get_event_count (port_buf);
+
+    if (event_count > BACKEND_MAX_MIDI_EVENTS)
+        event_count = BACKEND_MAX_MIDI_EVENTS;
+
+    /* the midi data stays valid until the end of the cycle */
+    for (jack_nframes_t i = 0; i < event_count; ++i) {
+        jack_midi_event_get (&in_event, port_buf, i);
+        events[i].time = in_event.time;
+        events[i].size = in_event.size;
+        events[i].buffer = in_event.buffer;
+    }
+
+    return cb->process (nframes, out, events, event_count, cb->arg);
+}
+
+static int srate (jack_nframes_t nframes, void *arg) {
+    return cb->srate (nframes, cb->arg);
+}
+
+static void jack_shutdown (void *arg) {
+    cb->shutdown (cb->arg);
+}
+
+static int jack_backend_open (const struct backend_config *config,
+                              const struct backend_callbacks *callbacks) {
+    cb = callbacks;
+
+    if ((client = jack_client_open (PACKAGE_NAME,
+                                    JackNullOption,
+                                    NULL)) == 0) {
+        fprintf (stderr, "Jack error: server not running?\n");
+        return -1;
+    }
+
+    cb->srate (jack_get_sample_rate (client), cb->arg);
+
+    jack_set_thread_init_callback (client, thread_init, 0);
+    jack_set_process_callback (client, process, 0);
+    jack_set_sample_rate_callback (client, srate, 0);
+    jack_on_shutdown (client, jack_shutdown, 0);
+
+    input_port = jack_port_register (client, "midi_in",
+            JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    output_port = jack_port_register (client, "audio_out",
+            JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+
+    return 0;
+}
+
+static int jack_backend_start (void) {
+    if (jack_activate (client)) {
+        fprintf (stderr, "Jack error: cannot activate client\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void jack_backend_close (void) {
+    jack_client_close (client);
+}
+
+const struct backend backend_jack = {
+    .name  = "jack",
+    .open  = jack_backend_open,
+    .start = jack_backend_start,
+    .close = jack_backend_close
+};
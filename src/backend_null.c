@@ -0,0 +1,158 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+    The null backend runs the process callback on a timer and throws the
+    sound away. It needs no audio stack at all. Midi can be fed from a
+    raw midi byte stream, such as a fifo or a /dev/snd/midiC*D* device.
+*/
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend.h"
+#include "rt.h"
+
+static const struct backend_callbacks *cb;
+
+static uint32_t srate;
+static uint32_t period;
+static int realtime;
+
+static float *buffer;
+
+static int midi_fd = -1;
+static struct backend_midi_parser midi_parser;
+
+static pthread_t thread;
+static volatile int running = 0;
+
+static uint32_t read_midi (void) {
+    unsigned char bytes[BACKEND_MAX_MIDI_EVENTS];
+    ssize_t n;
+
+    if (midi_fd < 0)
+        return 0;
+
+    if ((n = read (midi_fd, bytes, sizeof (bytes))) <= 0)
+        return 0;
+
+    return backend_midi_parse (&midi_parser, bytes, n);
+}
+
+static void *null_thread (void *arg) {
+    struct timespec next;
+    long period_ns = (long)((double)period * 1E9 / srate);
+
+    if (realtime)
+        rt_set_priority (BACKEND_RT_PRIORITY);
+    cb->thread_init (cb->arg);
+
+    clock_gettime (CLOCK_MONOTONIC, &next);
+
+    while (running) {
+        uint32_t event_count = read_midi ();
+
+        cb->process (period, buffer, midi_parser.events, event_count,
+                     cb->arg);
+
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    return NULL;
+}
+
+static int null_backend_open (const struct backend_config *config,
+                              const struct backend_callbacks *callbacks) {
+    cb = callbacks;
+
+    srate = config->srate;
+    period = config->period;
+    realtime = config->realtime;
+
+    if ((buffer = calloc (period, sizeof (float))) == NULL) {
+        fprintf (stderr, "Null error: cannot allocate buffer\n");
+        return -1;
+    }
+
+    if (config->midi_device
+        && (midi_fd = open (config->midi_device,
+                            O_RDONLY | O_NONBLOCK)) < 0) {
+        fprintf (stderr, "Null error: cannot open midi device %s: %s\n",
+                 config->midi_device, strerror (errno));
+        free (buffer);
+        buffer = NULL;
+        return -1;
+    }
+
+    cb->srate (srate, cb->arg);
+
+    return 0;
+}
+
+static int null_backend_start (void) {
+    int err;
+
+    running = 1;
+    if ((err = pthread_create (&thread, NULL, null_thread, NULL))) {
+        fprintf (stderr, "Null error: cannot create thread: %s\n",
+                 strerror (err));
+        running = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void null_backend_close (void) {
+    if (running) {
+        running = 0;
+        pthread_join (thread, NULL);
+    }
+
+    if (midi_fd >= 0) {
+        close (midi_fd);
+        midi_fd = -1;
+    }
+
+    free (buffer);
+    buffer = NULL;
+}
+
+const struct backend backend_null = {
+    .name  = "null",
+    .open  = null_backend_open,
+    .start = null_backend_start,
+    .close = null_backend_close
+};
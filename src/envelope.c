@@ -0,0 +1,171 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "envelope.h"
+
+#define ENVELOPE_BLOCK 32
+
+/* below this distance to its target, a curve has ended (-80dB) */
+static const float ENVELOPE_EPSILON = 1E-4f;
+
+/* decay and release times are the time to fall by 60dB */
+static const double LN_1000 = 6.907755279;
+
+typedef float v4sf __attribute__ ((vector_size (16)));
+
+/* out[i] *= value + i * step, four frames at a time. */
+static void ramp_mul (float *out, uint32_t nframes, float value, float step) {
+    const v4sf vvalue = { value, value, value, value };
+    const v4sf vstep = { step, step, step, step };
+    const v4sf four = { 4.f, 4.f, 4.f, 4.f };
+    v4sf index = { 0.f, 1.f, 2.f, 3.f };
+    uint32_t i = 0;
+
+    for (; i + 4 <= nframes; i += 4) {
+        v4sf o;
+
+        memcpy (&o, out + i, sizeof (o));
+        o *= vvalue + index * vstep;
+        memcpy (out + i, &o, sizeof (o));
+
+        index += four;
+    }
+
+    for (; i < nframes; ++i)
+        out[i] *= value + (float)i * step;
+}
+
+static float curve_coef (float time, uint32_t srate) {
+    if (time <= 0.f)
+        return 0.f;
+
+    return exp (-LN_1000 * ENVELOPE_BLOCK / (time * srate));
+}
+
+/* Prepare the ramp toward target, one block of an exponential curve. */
+static void curve_segment (struct envelope *env, float target, float coef) {
+    env->end = target + (env->level - target) * coef;
+    env->step = (env->end - env->level) / ENVELOPE_BLOCK;
+    env->frames_left = ENVELOPE_BLOCK;
+}
+
+static void hold_segment (struct envelope *env) {
+    env->end = env->level;
+    env->step = 0.f;
+    env->frames_left = UINT32_MAX;
+}
+
+static void next_segment (struct envelope *env) {
+    switch (env->stage) {
+    case ENVELOPE_ATTACK: {
+        float step = env->peak * env->attack_step;
+
+        if (env->level < env->peak && step > 0.f) {
+            env->frames_left = ceilf ((env->peak - env->level) / step);
+            env->step = step;
+            env->end = env->peak;
+            break;
+        }
+        env->stage = ENVELOPE_DECAY;
+    }
+        /* fall through */
+    case ENVELOPE_DECAY: {
+        float target = env->sustain * env->peak;
+
+        if (fabsf (env->level - target) >= ENVELOPE_EPSILON) {
+            curve_segment (env, target, env->decay_coef);
+            break;
+        }
+        env->level = target;
+        env->stage = ENVELOPE_SUSTAIN;
+        hold_segment (env);
+        break;
+    }
+    case ENVELOPE_RELEASE:
+        if (env->level >= ENVELOPE_EPSILON) {
+            curve_segment (env, 0.f, env->release_coef);
+            break;
+        }
+        env->level = 0.f;
+        env->stage = ENVELOPE_IDLE;
+        hold_segment (env);
+        break;
+    default:
+        hold_segment (env);
+        break;
+    }
+}
+
+void envelope_set_params (struct envelope *env,
+                          const struct envelope_params *params,
+                          uint32_t srate) {
+    /* a zero attack still ramps over one frame */
+    env->attack_step = params->attack * srate > 1.f
+        ? 1.f / (params->attack * srate)
+        : 1.f;
+    env->decay_coef = curve_coef (params->decay, srate);
+    env->release_coef = curve_coef (params->release, srate);
+    env->sustain = params->sustain;
+
+    env->frames_left = 0;
+}
+
+void envelope_note_on (struct envelope *env, float peak) {
+    env->stage = ENVELOPE_ATTACK;
+    env->peak = peak;
+    env->frames_left = 0;
+}
+
+void envelope_note_off (struct envelope *env) {
+    if (env->stage == ENVELOPE_IDLE)
+        return;
+
+    env->stage = ENVELOPE_RELEASE;
+    env->frames_left = 0;
+}
+
+void envelope_apply (struct envelope *env,
+                     float *out,
+                     uint32_t nframes,
+                     float gain) {
+    while (nframes > 0) {
+        uint32_t n;
+
+        if (env->frames_left == 0)
+            next_segment (env);
+
+        n = nframes < env->frames_left ? nframes : env->frames_left;
+
+        if (env->stage == ENVELOPE_IDLE)
+            memset (out, 0, n * sizeof (float));
+        else
+            ramp_mul (out, n, env->level * gain, env->step * gain);
+
+        env->frames_left -= n;
+        env->level = env->frames_left == 0
+            ? env->end
+            : env->level + n * env->step;
+
+        out += n;
+        nframes -= n;
+    }
+}
@@ -0,0 +1,77 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPC_ENVELOPE_H_
+#define JPC_ENVELOPE_H_
+
+#include <stdint.h>
+
+/* Times in seconds, sustain level between 0 and 1. */
+struct envelope_params {
+    float attack;
+    float decay;
+    float sustain;
+    float release;
+};
+
+enum envelope_stage {
+    ENVELOPE_IDLE,
+    ENVELOPE_ATTACK,
+    ENVELOPE_DECAY,
+    ENVELOPE_SUSTAIN,
+    ENVELOPE_RELEASE
+};
+
+/* An ADSR envelope, rendered as linear segments: the attack is a single
+   ramp, decay and release are exponential curves approximated by a ramp
+   every ENVELOPE_BLOCK frames. */
+struct envelope {
+    enum envelope_stage stage;
+
+    float peak;
+    float level;
+
+    /* current segment */
+    float    step;
+    float    end;
+    uint32_t frames_left;
+
+    /* per sample rate */
+    float attack_step;
+    float decay_coef;
+    float release_coef;
+    float sustain;
+};
+
+void envelope_set_params (struct envelope *env,
+                          const struct envelope_params *params,
+                          uint32_t srate);
+
+/* Start the attack toward peak, from the current level. */
+void envelope_note_on (struct envelope *env, float peak);
+
+void envelope_note_off (struct envelope *env);
+
+/* Multiply nframes of out by the envelope and by gain. */
+void envelope_apply (struct envelope *env,
+                     float *out,
+                     uint32_t nframes,
+                     float gain);
+
+#endif
@@ -17,10 +17,11 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define _GNU_SOURCE
+
 #include "config.h"
 
 #ifndef HAVE_GTK
-#   define _POSIX_SOURCE
 #   include <pthread.h>
 #   include <signal.h>
 #else
@@ -34,64 +35,119 @@
 #include <string.h>
 #include <unistd.h>
 
-#include <jack/jack.h>
-#include <jack/midiport.h>
-
+#include "backend.h"
+#include "envelope.h"
 #include "midi_notes.h"
+#include "rt.h"
 
-static const int MAX_POT_VALUE = 470000;
+/* State owned by the process callback, written on every frame. The type
+   is padded to whole cache lines, so that control changes and the other
+   globals do not bounce them between cores. */
+static struct rt_state {
+    int run_time_astable;
+    int run_time_monostable;
 
-static jack_port_t *input_port;
-static jack_port_t *output_port;
+    int output;
 
-static int pot1 = 100000;
-static int pot2 = 80000;
+    unsigned long midi_notes_played[4];
+    int current_midi_note_played;
+    int current_pitch_bend;
 
-static jack_nframes_t current_srate = 0;
+    struct envelope env;
 
-static int high_time_astable;
-static int  low_time_astable;
-static int high_time_monostable;
+#ifdef HAVE_GTK
+    int mouse_gate;
+#endif
+} CACHE_ALIGNED rt = {
+    .run_time_astable = 0,
+    .run_time_monostable = 0,
+    .output = 1,
+    .midi_notes_played = { 0, 0, 0, 0 },
+    .current_midi_note_played = -1,
+    .current_pitch_bend = 0,
+    .env = { .stage = ENVELOPE_IDLE },
+#ifdef HAVE_GTK
+    .mouse_gate = 0
+#endif
+};
 
-static int run_time_astable = 0;
-static int run_time_monostable = 0;
+/* State read by the process callback and written by the GUI and sample
+   rate changes, and by the audio thread itself on note on and pitch bend.
+   Padded to whole cache lines too. */
+static struct control_state {
+    int pot1;
+    int pot2;
 
-static int output = 1;
+    uint32_t current_srate;
 
-static float gain = .5f;
+    int high_time_astable;
+    int  low_time_astable;
+    int high_time_monostable;
 
-static unsigned long midi_notes_played[] = { 0, 0, 0, 0 };
-static int current_midi_note_played = -1;
-static int current_pitch_bend = 0;
+    float gain;
+
+#ifdef HAVE_GTK
+    int mouse_pressed;
+#endif
+} CACHE_ALIGNED ctl = {
+    .pot1 = 100000,
+    .pot2 = 80000,
+    .current_srate = 0,
+    .gain = .5f,
+#ifdef HAVE_GTK
+    .mouse_pressed = 0
+#endif
+};
 
 #ifndef HAVE_GTK
 static int running = 1;
-#else
-static int mouse_pressed = 0;
 #endif
 
-#define NOTE_ON(_note) do {                          \
-    if (_note < 0);                                  \
-    else if (_note < 32)                             \
-        midi_notes_played[0] |= 1 << (_note);        \
-    else if (_note < 64)                             \
-        midi_notes_played[1] |= 1 << ((_note) - 32); \
-    else if (_note < 96)                             \
-        midi_notes_played[2] |= 1 << ((_note) - 64); \
-    else if (_note < 128)                            \
-        midi_notes_played[3] |= 1 << ((_note) - 96); \
-} while (0)
+static int rt_cpu = -1;
+
+static double reference_freq = 0.0;
+static const char *scale_path = NULL;
+static const char *keymap_path = NULL;
+
+static struct envelope_params envelope_params = {
+    .attack = .002f,
+    .decay = 0.f,
+    .sustain = 1.f,
+    .release = .02f
+};
+
+static const struct backend *backend;
+
+static struct backend_config config = {
+    .device = "default",
+    .midi_device = NULL,
+    .srate = 48000,
+    .period = 256,
+    .realtime = 0
+};
 
-#define NOTE_OFF(_note) do {                            \
+#define NOTE_ON(_note) do {                             \
     if (_note < 0);                                     \
     else if (_note < 32)                                \
-        midi_notes_played[0] &= ~(1 << (_note));        \
+        rt.midi_notes_played[0] |= 1 << (_note);        \
     else if (_note < 64)                                \
-        midi_notes_played[1] &= ~(1 << ((_note) - 32)); \
+        rt.midi_notes_played[1] |= 1 << ((_note) - 32); \
     else if (_note < 96)                                \
-        midi_notes_played[2] &= ~(1 << ((_note) - 64)); \
+        rt.midi_notes_played[2] |= 1 << ((_note) - 64); \
     else if (_note < 128)                               \
-        midi_notes_played[3] &= ~(1 << ((_note) - 96)); \
+        rt.midi_notes_played[3] |= 1 << ((_note) - 96); \
+} while (0)
+
+#define NOTE_OFF(_note) do {                               \
+    if (_note < 0);                                        \
+    else if (_note < 32)                                   \
+        rt.midi_notes_played[0] &= ~(1 << (_note));        \
+    else if (_note < 64)                                   \
+        rt.midi_notes_played[1] &= ~(1 << ((_note) - 32)); \
+    else if (_note < 96)                                   \
+        rt.midi_notes_played[2] &= ~(1 << ((_note) - 64)); \
+    else if (_note < 128)                                  \
+        rt.midi_notes_played[3] &= ~(1 << ((_note) - 96)); \
 } while (0)
 
 #define GET_NOTE_AUX(_note) do {   \
@@ -103,20 +159,20 @@ static int mouse_pressed = 0;
 
 #define GET_NOTE(_note) do {                        \
     unsigned long ulnote;                           \
-    if        (midi_notes_played[0]) {              \
-        ulnote = midi_notes_played[0];              \
+    if        (rt.midi_notes_played[0]) {           \
+        ulnote = rt.midi_notes_played[0];           \
         _note = 0;                                  \
         GET_NOTE_AUX(_note);                        \
-    } else if (midi_notes_played[1]) {              \
-        ulnote = midi_notes_played[1];              \
+    } else if (rt.midi_notes_played[1]) {           \
+        ulnote = rt.midi_notes_played[1];           \
         _note = 32;                                 \
         GET_NOTE_AUX(_note);                        \
-    } else if (midi_notes_played[2]) {              \
-        ulnote = midi_notes_played[2];              \
+    } else if (rt.midi_notes_played[2]) {           \
+        ulnote = rt.midi_notes_played[2];           \
         _note = 64;                                 \
         GET_NOTE_AUX(_note);                        \
-    } else if (midi_notes_played[3]) {              \
-        ulnote = midi_notes_played[3];              \
+    } else if (rt.midi_notes_played[3]) {           \
+        ulnote = rt.midi_notes_played[3];           \
         _note = 96;                                 \
         GET_NOTE_AUX(_note);                        \
     } else {                                        \
@@ -124,70 +180,131 @@ static int mouse_pressed = 0;
     }                                               \
 } while (0)
 
-#define IS_NOTE_ON() (midi_notes_played[0] \
-    || midi_notes_played[1]                \
-    || midi_notes_played[2]                \
-    || midi_notes_played[3])
+#define IS_NOTE_ON() (rt.midi_notes_played[0] \
+    || rt.midi_notes_played[1]                \
+    || rt.midi_notes_played[2]                \
+    || rt.midi_notes_played[3])
 
 #define IS_NOTE_OFF() (! IS_NOTE_ON())
 
 static void update_pot_values (int p1, int p2) {
-    high_time_astable = 0.693*((float)p1 + 1000.0)*.01E-6*current_srate;
-    low_time_astable = 0.693*((float)p1)*.01E-6*current_srate;
-    high_time_monostable = 0.693*((float)p2)*.1E-6*current_srate;
+    ctl.high_time_astable = ASTABLE_HIGH_TIME((double)p1)*ctl.current_srate;
+    ctl.low_time_astable = ASTABLE_LOW_TIME((double)p1)*ctl.current_srate;
+    ctl.high_time_monostable = MONOSTABLE_TIME((double)p2)*ctl.current_srate;
 
-    pot1 = p1;
-    pot2 = p2;
+    ctl.pot1 = p1;
+    ctl.pot2 = p2;
 }
 
-static void update_srate (jack_nframes_t srate) {
-    float slope = current_srate == 0 ? 1.f : (float)srate/current_srate;
+/* The timings of a note come straight from the note table, only the pitch
+   wheel moving the monostable potentiometer needs computing. */
+static void play_note (int note, int pitch_bend) {
+    const struct midi_notes_t *n = &midi_notes[note];
+    double p2 = n->pot2;
 
-    current_srate = srate;
+    ctl.high_time_astable = n->high_time_astable;
+    ctl.low_time_astable = n->low_time_astable;
 
-    update_pot_values (pot1, pot2);
+    if (pitch_bend == 0) {
+        ctl.high_time_monostable = n->high_time_monostable;
+    } else {
+        if (pitch_bend > 0)
+            p2 -= (double)pitch_bend/0x2000 * n->pot2;
+        else
+            p2 -= (double)pitch_bend/0x2000 * (MAX_POT_VALUE - n->pot2);
+
+        ctl.high_time_monostable = MONOSTABLE_TIME(p2)*ctl.current_srate;
+    }
 
-    run_time_astable *= slope;
-    run_time_monostable *= slope;
+    ctl.pot1 = n->pot1;
+    ctl.pot2 = p2;
 }
 
-static int process (jack_nframes_t nframes, void *arg) {
-    void* port_buf = jack_port_get_buffer (input_port, nframes);
+static void update_srate (uint32_t srate) {
+    float slope = ctl.current_srate == 0
+        ? 1.f
+        : (float)srate/ctl.current_srate;
 
-    jack_default_audio_sample_t *out = (jack_default_audio_sample_t *)
-        jack_port_get_buffer (output_port, nframes);
+    ctl.current_srate = srate;
 
-    jack_midi_event_t in_event;
-    jack_nframes_t event_index = 0;
-    jack_nframes_t event_count = jack_midi_get_event_count (port_buf);
+    midi_notes_update_srate (srate);
+    update_pot_values (ctl.pot1, ctl.pot2);
 
-    if (event_count > 0)
-        jack_midi_event_get (&in_event, port_buf, 0);
+    rt.run_time_astable *= slope;
+    rt.run_time_monostable *= slope;
 
-    for (jack_nframes_t i = 0; i < nframes; ++i) {
-        while ((in_event.time == i) && (event_index < event_count)) {
-            int previous_note_played = current_midi_note_played;
-            int previous_pitch_bend = current_pitch_bend;
-            if ( ((*(in_event.buffer) & 0xf0)) == 0x90 ) {
-                /* note on */
-                int note = *(in_event.buffer + 1);
+    envelope_set_params (&rt.env, &envelope_params, srate);
+}
+
+static int process (uint32_t nframes,
+                    float *out,
+                    const struct backend_midi_event *events,
+                    uint32_t event_count,
+                    void *arg) {
+    uint32_t event_index = 0;
+
+#ifdef HAVE_GTK
+    /* the gui plays at full velocity, but only when no note is held */
+    if (ctl.mouse_pressed != rt.mouse_gate) {
+        rt.mouse_gate = ctl.mouse_pressed;
+        if (IS_NOTE_OFF()) {
+            if (rt.mouse_gate)
+                envelope_note_on (&rt.env, 1.f);
+            else
+                envelope_note_off (&rt.env);
+        }
+    }
+#endif
+
+    for (uint32_t i = 0; i < nframes; ) {
+        uint32_t next;
+
+        while (   event_index < event_count
+               && events[event_index].time <= i) {
+            const unsigned char *buffer = events[event_index].buffer;
+            int previous_note_played = rt.current_midi_note_played;
+            int previous_pitch_bend = rt.current_pitch_bend;
+            int status = 0;
+
+            /* the messages handled below are all three bytes long, skip
+               anything shorter */
+            if (events[event_index].size >= 3)
+                status = *(buffer) & 0xf0;
+
+            /* a note on with a null velocity is a note off */
+            if (status == 0x90 && buffer[2] == 0)
+                status = 0x80;
 
-                NOTE_ON(note);
-                current_midi_note_played = note;
-            } else if ( ((*(in_event.buffer)) & 0xf0) == 0x80 ) {
+            if ( status == 0x90 ) {
+                /* note on, unless not mapped to the scale */
+                int note = *(buffer + 1) & 0x7f;
+
+                if (midi_notes[note].freq > 0.0) {
+                    NOTE_ON(note);
+                    rt.current_midi_note_played = note;
+
+                    envelope_note_on (&rt.env, (buffer[2] & 0x7f) / 127.f);
+                }
+            } else if ( status == 0x80 ) {
                 /* note off */
-                int note = *(in_event.buffer + 1);
+                int note = *(buffer + 1) & 0x7f;
 
                 NOTE_OFF(note);
 
                 /* any note still pressed? */
                 GET_NOTE(note);
-                current_midi_note_played = note;
-            } else if ( ((*(in_event.buffer)) & 0xf0) == 0xe0) {
+                rt.current_midi_note_played = note;
+
+                if (note == -1
+#ifdef HAVE_GTK
+                    && ! rt.mouse_gate
+#endif
+                    )
+                    envelope_note_off (&rt.env);
+            } else if ( status == 0xe0) {
                 /* pitch bend */
-                int pitch = (in_event.buffer[1] & 0x7f)
-                         | ((in_event.buffer[2] & 0x7f) << 7);
-                int note;
+                int pitch = (buffer[1] & 0x7f)
+                         | ((buffer[2] & 0x7f) << 7);
 
                 /* normalize */
                 if (pitch >= 0x2000)
@@ -195,64 +312,64 @@ static int process (jack_nframes_t nframes, void *arg) {
                 else
                     pitch = -(0x2000-pitch);
 
-                current_pitch_bend = pitch;
+                rt.current_pitch_bend = pitch;
             }
 
-            if (   current_midi_note_played != -1
-                && (current_midi_note_played != previous_note_played
-                    || current_pitch_bend != previous_pitch_bend)) {
-                double center
-                    = midi_notes[current_midi_note_played].pot2;
-                
-                int p1 = midi_notes[current_midi_note_played].pot1;
-                if (current_pitch_bend >= 0)
-                    update_pot_values(p1, center
-                        - (double)current_pitch_bend/0x2000 * center);
-                else
-                    update_pot_values(p1, center
-                        - (double)current_pitch_bend/0x2000
-                            * (MAX_POT_VALUE - center));
-            }
+            if (   rt.current_midi_note_played != -1
+                && (rt.current_midi_note_played != previous_note_played
+                    || rt.current_pitch_bend != previous_pitch_bend))
+                play_note (rt.current_midi_note_played,
+                           rt.current_pitch_bend);
 
             ++event_index;
-            if (event_index < event_count)
-                jack_midi_event_get (&in_event, port_buf, event_index);
         }
 
-        if (run_time_astable >= high_time_astable + low_time_astable)
-            run_time_astable = 0;
-
-        if (run_time_monostable >= high_time_monostable) {
-            output = 0;
-            if (run_time_astable == high_time_astable) {
-                run_time_monostable = 0;
-                output = 1;
+        /* render up to the next event */
+        next = event_index < event_count && events[event_index].time < nframes
+            ? events[event_index].time
+            : nframes;
+
+        for (uint32_t j = i; j < next; ++j) {
+            if (rt.run_time_astable
+                    >= ctl.high_time_astable + ctl.low_time_astable)
+                rt.run_time_astable = 0;
+
+            if (rt.run_time_monostable >= ctl.high_time_monostable) {
+                rt.output = 0;
+                if (rt.run_time_astable == ctl.high_time_astable) {
+                    rt.run_time_monostable = 0;
+                    rt.output = 1;
+                }
             }
+
+            rt.run_time_astable ++;
+            rt.run_time_monostable ++;
+
+            out[j] = rt.output ? 1.f : -1.f;
         }
 
-        run_time_astable ++;
-        run_time_monostable ++;
+        envelope_apply (&rt.env, out + i, next - i, ctl.gain);
 
-        out[i] = (
-#ifdef HAVE_GTK
-                  mouse_pressed
-#else
-                  0
-#endif
-                                 || IS_NOTE_ON())
-            ? (output ? 1.f : -1.f) * gain
-            : 0.0f;
+        i = next;
     }
     return 0;
 }
 
-static int srate (jack_nframes_t nframes, void *arg) {
+static int srate (uint32_t nframes, void *arg) {
     update_srate (nframes);
 
     return 0;
 }
 
-static void jack_shutdown (void *arg) {
+static void thread_init (void *arg) {
+    if (config.realtime)
+        rt_prefault_stack ();
+
+    if (rt_cpu >= 0)
+        rt_pin_thread (rt_cpu);
+}
+
+static void audio_shutdown (void *arg) {
 #ifndef HAVE_GTK
     running = 0;
 #endif
@@ -277,9 +394,9 @@ static gboolean potchange (GtkRange *range,
     struct pot_widgets *pw = (struct pot_widgets *)user_data;
 
     if ((GtkWidget *)range == pw->pot1)
-        update_pot_values (CLAMPVAL(value, 0, MAX_POT_VALUE), pot2);
+        update_pot_values (CLAMPVAL(value, 0, MAX_POT_VALUE), ctl.pot2);
     else
-        update_pot_values (pot1, CLAMPVAL(value, 0, MAX_POT_VALUE));
+        update_pot_values (ctl.pot1, CLAMPVAL(value, 0, MAX_POT_VALUE));
 
     gtk_widget_queue_draw (pw->twodslider);
 
@@ -290,7 +407,7 @@ static gboolean gainchange (GtkRange     *range,
                             GtkScrollType scroll,
                             gdouble       value,
                             gpointer      user_data) {
-    gain = CLAMPVAL(value, 0.0, 1.0);
+    ctl.gain = CLAMPVAL(value, 0.0, 1.0);
 
     return FALSE;
 }
@@ -305,8 +422,8 @@ static gboolean draw_callback (GtkWidget *widget,
     height = gtk_widget_get_allocated_height (widget);
 
     cairo_arc (cr,
-               ((double)pot1/MAX_POT_VALUE)*width,
-               height-((double)pot2/MAX_POT_VALUE)*height,
+               ((double)ctl.pot1/MAX_POT_VALUE)*width,
+               height-((double)ctl.pot2/MAX_POT_VALUE)*height,
                5,
                0, 2 * G_PI);
 
@@ -336,16 +453,16 @@ static gboolean mouse_button_event (GtkWidget *widget,
                            (1.0 - CLAMPVAL(e->y/height,0.0,1.0))*MAX_POT_VALUE);
 
 
-        gtk_range_set_value (GTK_RANGE (pw->pot1), pot1);
-        gtk_range_set_value (GTK_RANGE (pw->pot2), pot2);
+        gtk_range_set_value (GTK_RANGE (pw->pot1), ctl.pot1);
+        gtk_range_set_value (GTK_RANGE (pw->pot2), ctl.pot2);
 
         gtk_widget_queue_draw (widget);
     }
 
     if (e->type == GDK_BUTTON_PRESS) {
-        mouse_pressed = 1;
+        ctl.mouse_pressed = 1;
     } else if (e->type == GDK_BUTTON_RELEASE) {
-        mouse_pressed = 0;
+        ctl.mouse_pressed = 0;
     }
 
     return FALSE;
@@ -375,8 +492,8 @@ static gboolean mouse_motion_event (GtkWidget *widget,
         update_pot_values (CLAMPVAL((double)x/width,0.0,1.0) * MAX_POT_VALUE,
                            (1.0 - CLAMPVAL((double)y/height,0.0,1.0))
                                    * MAX_POT_VALUE);
-        gtk_range_set_value (GTK_RANGE (pw->pot1), pot1);
-        gtk_range_set_value (GTK_RANGE (pw->pot2), pot2);
+        gtk_range_set_value (GTK_RANGE (pw->pot1), ctl.pot1);
+        gtk_range_set_value (GTK_RANGE (pw->pot2), ctl.pot2);
         gtk_widget_queue_draw (widget);
     }
 
@@ -415,7 +532,7 @@ static void activate (GtkApplication *app, gpointer user_data) {
                                             0.0,
                                             MAX_POT_VALUE,
                                             10.0);
-    gtk_range_set_value (GTK_RANGE (pot1_widget), pot1);
+    gtk_range_set_value (GTK_RANGE (pot1_widget), ctl.pot1);
     gtk_widget_add_events (pot1_widget,
                              GDK_BUTTON_PRESS_MASK
                            | GDK_BUTTON_RELEASE_MASK);
@@ -424,7 +541,7 @@ static void activate (GtkApplication *app, gpointer user_data) {
                                             0.0,
                                             MAX_POT_VALUE,
                                             10.0);
-    gtk_range_set_value (GTK_RANGE (pot2_widget), pot2);
+    gtk_range_set_value (GTK_RANGE (pot2_widget), ctl.pot2);
     gtk_widget_add_events (pot2_widget,
                              GDK_BUTTON_PRESS_MASK
                            | GDK_BUTTON_RELEASE_MASK);
@@ -433,7 +550,7 @@ static void activate (GtkApplication *app, gpointer user_data) {
                                         0.0,
                                         1.0,
                                         0.05);
-    gtk_range_set_value (GTK_RANGE (potgain), gain);
+    gtk_range_set_value (GTK_RANGE (potgain), ctl.gain);
 
     labelpot1 = gtk_label_new ("Astable potentiometer");
     labelpot2 = gtk_label_new ("Monostable potentiometer");
@@ -513,30 +630,186 @@ static void signal_setup (void) {
 }
 #endif
 
+static const struct backend_callbacks callbacks = {
+    .thread_init = thread_init,
+    .process = process,
+    .srate = srate,
+    .shutdown = audio_shutdown,
+    .arg = NULL
+};
+
+static void usage (const char *name) {
+    fprintf (stderr,
+             "Usage: %s [-r] [-c cpu] [-b backend] [-d device] [-m device]\n"
+             "       [-s rate] [-p frames] [-e a,d,s,r] [-f freq]\n"
+             "       [-t file.scl] [-k file.kbm]\n"
+             "  -r          rt mode: lock and prefault the memory used by\n"
+             "              the audio thread\n"
+             "  -c cpu      pin the audio thread to the given cpu\n"
+             "  -b backend  audio backend (",
+             name);
+    backend_print_list (stderr);
+    fprintf (stderr,
+             ")\n"
+             "  -d device   alsa pcm device (default: %s)\n"
+             "  -m device   alsa rawmidi device, or raw midi stream of the\n"
+             "              null backend (default: none)\n"
+             "  -s rate     sample rate of the alsa and null backends\n"
+             "              (default: %u)\n"
+             "  -p frames   period size of the alsa and null backends\n"
+             "              (default: %u)\n"
+             "  -e a,d,s,r  envelope: attack, decay and release in ms,\n"
+             "              sustain level between 0 and 1\n"
+             "              (default: %g,%g,%g,%g)\n"
+             "  -f freq     reference frequency, of A4 unless changed by the\n"
+             "              keyboard mapping (default: 440)\n"
+             "  -t file     scala scale file (default: 12 equal)\n"
+             "  -k file     scala keyboard mapping file\n"
+             "  -h          show this help\n",
+             config.device, config.srate, config.period,
+             envelope_params.attack * 1000.f,
+             envelope_params.decay * 1000.f,
+             envelope_params.sustain,
+             envelope_params.release * 1000.f);
+}
+
+static int parse_uint (const char *arg, const char *what, uint32_t *value) {
+    char *end;
+    long l = strtol (arg, &end, 10);
+
+    if (*end != '\0' || l <= 0) {
+        fprintf (stderr, "Invalid %s: %s\n", what, arg);
+        return -1;
+    }
+
+    *value = l;
+
+    return 0;
+}
+
+static int parse_envelope (const char *arg) {
+    float a, d, s, r;
+    char end;
+
+    if (sscanf (arg, "%f,%f,%f,%f%c", &a, &d, &s, &r, &end) != 4
+        || ! isfinite (a) || ! isfinite (d)
+        || ! isfinite (s) || ! isfinite (r)
+        || a < 0.f || d < 0.f || s < 0.f || s > 1.f || r < 0.f) {
+        fprintf (stderr, "Invalid envelope: %s\n", arg);
+        return -1;
+    }
+
+    envelope_params.attack = a / 1000.f;
+    envelope_params.decay = d / 1000.f;
+    envelope_params.sustain = s;
+    envelope_params.release = r / 1000.f;
+
+    return 0;
+}
+
+static int parse_options (int argc, char **argv) {
+    int opt;
+
+    while ((opt = getopt (argc, argv, "rc:b:d:m:s:p:e:f:t:k:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            config.realtime = 1;
+            break;
+        case 'c': {
+            char *end;
+
+            rt_cpu = strtol (optarg, &end, 10);
+            if (end == optarg || *end != '\0' || rt_cpu < 0) {
+                fprintf (stderr, "Invalid cpu: %s\n", optarg);
+                return -1;
+            }
+            if (rt_check_cpu (rt_cpu))
+                return -1;
+            break;
+        }
+        case 'b':
+            if ((backend = backend_find (optarg)) == NULL) {
+                fprintf (stderr, "Unknown backend: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'd':
+            config.device = optarg;
+            break;
+        case 'm':
+            config.midi_device = optarg;
+            break;
+        case 's':
+            if (parse_uint (optarg, "sample rate", &config.srate))
+                return -1;
+            break;
+        case 'p':
+            if (parse_uint (optarg, "period size", &config.period))
+                return -1;
+            break;
+        case 'e':
+            if (parse_envelope (optarg))
+                return -1;
+            break;
+        case 'f': {
+            char *end;
+
+            reference_freq = strtod (optarg, &end);
+            if (*end != '\0' || ! isfinite (reference_freq)
+                || reference_freq <= 0.0) {
+                fprintf (stderr, "Invalid frequency: %s\n", optarg);
+                return -1;
+            }
+            break;
+        }
+        case 't':
+            scale_path = optarg;
+            break;
+        case 'k':
+            keymap_path = optarg;
+            break;
+        case 'h':
+        default:
+            usage (argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int rt_setup (void) {
+    if (rt_lock_memory ())
+        return -1;
+
+    /* everything the process callback may touch, so that the first note
+       does not page fault */
+    rt_prefault (&rt, sizeof (rt));
+    rt_prefault (&ctl, sizeof (ctl));
+    rt_prefault (midi_notes, sizeof (midi_notes));
+
+    return 0;
+}
+
 int main (int argc, char **argv) {
     printf (PACKAGE_STRING"\n");
 
-    jack_client_t *client;
-    if ((client = jack_client_open (PACKAGE_NAME,
-                                    JackNullOption,
-                                    NULL)) == 0) {
-        fprintf (stderr, "Jack error: server not running?\n");
+    backend = backend_find (NULL);
+
+    if (parse_options (argc, argv))
         return 1;
-    }
 
-    update_srate (jack_get_sample_rate (client));
+    if (midi_notes_init (reference_freq, scale_path, keymap_path))
+        return 1;
 
-    jack_set_process_callback (client, process, 0);
-    jack_set_sample_rate_callback (client, srate, 0);
-    jack_on_shutdown (client, jack_shutdown, 0);
+    if (config.realtime && rt_setup ())
+        return 1;
 
-    input_port = jack_port_register (client, "midi_in",
-            JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
-    output_port = jack_port_register (client, "audio_out",
-            JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    if (backend->open (&config, &callbacks))
+        return 1;
 
-    if (jack_activate (client)) {
-        fprintf (stderr, "Jack error: cannot activate client");
+    if (backend->start ()) {
+        backend->close ();
         return 1;
     }
 
@@ -545,7 +818,10 @@ int main (int argc, char **argv) {
     app = gtk_application_new ("be.witryk.jackpunkconsole",
                                G_APPLICATION_FLAGS_NONE);
     g_signal_connect (app, "activate", G_CALLBACK (activate), NULL);
-    g_application_run (G_APPLICATION (app), argc, argv);
+    /* options have already been consumed */
+    argv[optind - 1] = argv[0];
+    g_application_run (G_APPLICATION (app),
+                       argc - optind + 1, argv + optind - 1);
     g_object_unref (app);
 #else
     signal_setup ();
@@ -553,7 +829,7 @@ int main (int argc, char **argv) {
     while (running) pause ();
 #endif
 
-    jack_client_close (client);
+    backend->close ();
 
     fprintf (stdout, "Bye.\n");
 
@@ -17,135 +17,99 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <math.h>
+
 #include "midi_notes.h"
+#include "scala.h"
+
+struct midi_notes_t midi_notes[MIDI_NOTES_COUNT];
+
+/* Find potentiometer values for a frequency. The monostable lets k
+   astable periods go by before being triggered again, so the sound is
+   the astable frequency divided by k. */
+static int solve_pots (double freq, double *pot1, double *pot2) {
+    const double max_astable = ASTABLE_HIGH_TIME(MAX_POT_VALUE)
+                             + ASTABLE_LOW_TIME(MAX_POT_VALUE);
+    const double max_monostable = MONOSTABLE_TIME(MAX_POT_VALUE);
+    double period = 1.0 / freq;
+    double k = ceil (period / max_astable);
+    double astable = period / k;
+    double monostable = (k - .5) * astable;
+
+    if ((k - 1.0) * astable >= max_monostable)
+        return -1;
+
+    /* in the middle of the window between two triggers, when possible */
+    if (monostable > max_monostable)
+        monostable = ((k - 1.0) * astable + max_monostable) / 2.0;
+
+    /* inverse of the timings, ASTABLE_LOW_TIME(1.0) being per ohm */
+    *pot1 = (astable / ASTABLE_LOW_TIME(1.0) - 1000.0) / 2.0;
+    if (*pot1 < 0.0)
+        *pot1 = 0.0;
+    *pot2 = monostable / MONOSTABLE_TIME(1.0);
+
+    return 0;
+}
+
+int midi_notes_init (double reference_freq,
+                     const char *scale_path,
+                     const char *keymap_path) {
+    struct scala_scale scale;
+    struct scala_keymap keymap;
+
+    scala_default_scale (&scale);
+    scala_default_keymap (&keymap);
+
+    if (scale_path && scala_load_scale (scale_path, &scale))
+        return -1;
+    if (keymap_path && scala_load_keymap (keymap_path, &keymap))
+        return -1;
+
+    if (reference_freq > 0.0)
+        keymap.freq = reference_freq;
+
+    for (int i = 0; i < MIDI_NOTES_COUNT; i++) {
+        struct midi_notes_t *n = &midi_notes[i];
+        double freq;
+
+        n->note = i;
+        n->freq = freq = scala_frequency (&scale, &keymap, i);
+        n->pot1 = n->pot2 = 0.0;
+
+        if (freq <= 0.0)
+            continue;
+
+        /* below the range of the circuit, play octaves up */
+        while (solve_pots (freq, &n->pot1, &n->pot2))
+            freq *= 2.0;
+    }
+
+    return 0;
+}
+
+void midi_notes_update_srate (uint32_t srate) {
+    for (int i = 0; i < MIDI_NOTES_COUNT; i++) {
+        struct midi_notes_t *n = &midi_notes[i];
+        double high = ASTABLE_HIGH_TIME(n->pot1) * srate;
+        double low = ASTABLE_LOW_TIME(n->pot1) * srate;
+        int period;
+
+        if (n->freq <= 0.0) {
+            n->high_time_astable = 0;
+            n->low_time_astable = 0;
+            n->high_time_monostable = 0;
+            continue;
+        }
 
-struct midi_notes_t midi_notes[] = {
-    { .note=0,   .freq=8.175798916, .pot1=0,           .pot2=0           },
-    { .note=1,   .freq=8.661957218, .pot1=0,           .pot2=0           },
-    { .note=2,   .freq=9.177023997, .pot1=0,           .pot2=0           },
-    { .note=3,   .freq=9.722718241, .pot1=0,           .pot2=0           },
-    { .note=4,   .freq=10.30086115, .pot1=0,           .pot2=0           },
-    { .note=5,   .freq=10.91338223, .pot1=0,           .pot2=0           },
-    { .note=6,   .freq=11.56232571, .pot1=0,           .pot2=0           },
-    { .note=7,   .freq=12.24985737, .pot1=0,           .pot2=0           },
-    { .note=8,   .freq=12.9782718,  .pot1=0,           .pot2=0           },
-    { .note=9,   .freq=13.75,       .pot1=0,           .pot2=0           },
-    { .note=10,  .freq=14.56761755, .pot1=0,           .pot2=0           },
-    { .note=11,  .freq=15.43385316, .pot1=0,           .pot2=0           },
-    { .note=12,  .freq=16.35159783, .pot1=0,           .pot2=0           },
-    { .note=13,  .freq=17.32391444, .pot1=0,           .pot2=0           },
-    { .note=14,  .freq=18.35404799, .pot1=0,           .pot2=0           },
-    { .note=15,  .freq=19.44543648, .pot1=0,           .pot2=0           },
-    { .note=16,  .freq=20.60172231, .pot1=0,           .pot2=0           },
-    { .note=17,  .freq=21.82676446, .pot1=0,           .pot2=0           },
-    { .note=18,  .freq=23.12465142, .pot1=0,           .pot2=0           },
-    { .note=19,  .freq=24.49971475, .pot1=0,           .pot2=0           },
-    { .note=20,  .freq=25.9565436,  .pot1=0,           .pot2=0           },
-    { .note=21,  .freq=27.5,        .pot1=327454.8734, .pot2=462654.4415 },
-    { .note=22,  .freq=29.13523509, .pot1=309048.1807, .pot2=436647.9936 },
-    { .note=23,  .freq=30.86770633, .pot1=291674.5763, .pot2=412101.1754 },
-    { .note=24,  .freq=32.70319566, .pot1=275276.0774, .pot2=388932.0643 },
-    { .note=25,  .freq=34.64782887, .pot1=259797.9555, .pot2=367063.3354 },
-    { .note=26,  .freq=36.70809599, .pot1=245188.5539, .pot2=346422.004  },
-    { .note=27,  .freq=38.89087297, .pot1=463298.2298, .pot2=282148.622  },
-    { .note=28,  .freq=41.20344461, .pot1=437267.2354, .pot2=266295.7464 },
-    { .note=29,  .freq=43.65352893, .pot1=412697.2484, .pot2=251332.6243 },
-    { .note=30,  .freq=46.24930284, .pot1=389506.2689, .pot2=237209.3177 },
-    { .note=31,  .freq=48.9994295,  .pot1=367616.899,  .pot2=223878.6915 },
-    { .note=32,  .freq=51.9130872,  .pot1=346956.085,  .pot2=211296.2558 },
-    { .note=33,  .freq=55,          .pot1=327454.8734, .pot2=199420.0179 },
-    { .note=34,  .freq=58.27047019, .pot1=309048.1807, .pot2=188210.3421 },
-    { .note=35,  .freq=61.73541266, .pot1=291674.5763, .pot2=177629.817  },
-    { .note=36,  .freq=65.40639133, .pot1=275276.0774, .pot2=167643.1311 },
-    { .note=37,  .freq=69.29565774, .pot1=259797.9555, .pot2=158216.9549 },
-    { .note=38,  .freq=73.41619198, .pot1=245188.5539, .pot2=149319.8293 },
-    { .note=39,  .freq=77.78174593, .pot1=463298.2298, .pot2=97292.62826 },
-    { .note=40,  .freq=82.40688923, .pot1=437267.2354, .pot2=91826.11943 },
-    { .note=41,  .freq=87.30705786, .pot1=412697.2484, .pot2=86666.42217 },
-    { .note=42,  .freq=92.49860568, .pot1=389506.2689, .pot2=81796.31646 },
-    { .note=43,  .freq=97.998859,   .pot1=367616.899,  .pot2=77199.54878 },
-    { .note=44,  .freq=103.8261744, .pot1=346956.085,  .pot2=72860.77785 },
-    { .note=45,  .freq=110,         .pot1=327454.8734, .pot2=68765.52342 },
-    { .note=46,  .freq=116.5409404, .pot1=309048.1807, .pot2=64900.11795 },
-    { .note=47,  .freq=123.4708253, .pot1=291674.5763, .pot2=61251.66103 },
-    { .note=48,  .freq=130.8127827, .pot1=275276.0774, .pot2=57807.97626 },
-    { .note=49,  .freq=138.5913155, .pot1=259797.9555, .pot2=54557.57066 },
-    { .note=50,  .freq=146.832384,  .pot1=245188.5539, .pot2=51489.59631 },
-    { .note=51,  .freq=155.5634919, .pot1=463298.2298, .pot2=46329.82298 },
-    { .note=52,  .freq=164.8137785, .pot1=437267.2354, .pot2=43726.72354 },
-    { .note=53,  .freq=174.6141157, .pot1=412697.2484, .pot2=41269.72484 },
-    { .note=54,  .freq=184.9972114, .pot1=389506.2689, .pot2=38950.62689 },
-    { .note=55,  .freq=195.997718,  .pot1=367616.899,  .pot2=36761.6899  },
-    { .note=56,  .freq=207.6523488, .pot1=346956.085,  .pot2=34695.6085  },
-    { .note=57,  .freq=220,         .pot1=327454.8734, .pot2=32745.48734 },
-    { .note=58,  .freq=233.0818808, .pot1=309048.1807, .pot2=30904.81807 },
-    { .note=59,  .freq=246.9416506, .pot1=291674.5763, .pot2=29167.45763 },
-    { .note=60,  .freq=261.6255653, .pot1=275276.0774, .pot2=27527.60774 },
-    { .note=61,  .freq=277.182631,  .pot1=259797.9555, .pot2=25979.79555 },
-    { .note=62,  .freq=293.6647679, .pot1=245188.5539, .pot2=24518.85539 },
-    { .note=63,  .freq=311.1269837, .pot1=231399.1149, .pot2=23139.91149 },
-    { .note=64,  .freq=329.6275569, .pot1=218383.6177, .pot2=21838.36177 },
-    { .note=65,  .freq=349.2282314, .pot1=206098.6242, .pot2=20609.86242 },
-    { .note=66,  .freq=369.9944227, .pot1=194503.1344, .pot2=19450.31344 },
-    { .note=67,  .freq=391.995436,  .pot1=183558.4495, .pot2=18355.84495 },
-    { .note=68,  .freq=415.3046976, .pot1=173228.0425, .pot2=17322.80425 },
-    { .note=69,  .freq=440,         .pot1=163477.4367, .pot2=16347.74367 },
-    { .note=70,  .freq=466.1637615, .pot1=154274.0904, .pot2=15427.40904 },
-    { .note=71,  .freq=493.8833013, .pot1=145587.2882, .pot2=14558.72882 },
-    { .note=72,  .freq=523.2511306, .pot1=137388.0387, .pot2=13738.80387 },
-    { .note=73,  .freq=554.365262,  .pot1=129648.9778, .pot2=12964.89778 },
-    { .note=74,  .freq=587.3295358, .pot1=122344.2769, .pot2=12234.42769 },
-    { .note=75,  .freq=622.2539674, .pot1=115449.5575, .pot2=11544.95575 },
-    { .note=76,  .freq=659.2551138, .pot1=108941.8088, .pot2=10894.18088 },
-    { .note=77,  .freq=698.4564629, .pot1=102799.3121, .pot2=10279.93121 },
-    { .note=78,  .freq=739.9888454, .pot1=97001.56721, .pot2=9700.156721 },
-    { .note=79,  .freq=783.990872,  .pot1=91529.22474, .pot2=9152.922474 },
-    { .note=80,  .freq=830.6093952, .pot1=86364.02125, .pot2=8636.402125 },
-    { .note=81,  .freq=880,         .pot1=81488.71835, .pot2=8148.871835 },
-    { .note=82,  .freq=932.327523,  .pot1=76887.04518, .pot2=7688.704518 },
-    { .note=83,  .freq=987.7666025, .pot1=72543.64408, .pot2=7254.364408 },
-    { .note=84,  .freq=1046.502261, .pot1=68444.01935, .pot2=6844.401935 },
-    { .note=85,  .freq=1108.730524, .pot1=64574.48888, .pot2=6457.448888 },
-    { .note=86,  .freq=1174.659072, .pot1=60922.13847, .pot2=6092.213847 },
-    { .note=87,  .freq=1244.507935, .pot1=57474.77873, .pot2=5747.477873 },
-    { .note=88,  .freq=1318.510228, .pot1=54220.90442, .pot2=5422.090442 },
-    { .note=89,  .freq=1396.912926, .pot1=51149.65605, .pot2=5114.965605 },
-    { .note=90,  .freq=1479.977691, .pot1=48250.78361, .pot2=4825.078361 },
-    { .note=91,  .freq=1567.981744, .pot1=45514.61237, .pot2=4551.461237 },
-    { .note=92,  .freq=1661.21879,  .pot1=42932.01062, .pot2=4293.201062 },
-    { .note=93,  .freq=1760,        .pot1=40494.35918, .pot2=4049.435918 },
-    { .note=94,  .freq=1864.655046, .pot1=38193.52259, .pot2=3819.352259 },
-    { .note=95,  .freq=1975.533205, .pot1=36021.82204, .pot2=3602.182204 },
-    { .note=96,  .freq=2093.004522, .pot1=33972.00968, .pot2=3397.200968 },
-    { .note=97,  .freq=2217.461048, .pot1=32037.24444, .pot2=3203.724444 },
-    { .note=98,  .freq=2349.318143, .pot1=30211.06923, .pot2=3021.106923 },
-    { .note=99,  .freq=2489.01587,  .pot1=28487.38936, .pot2=2848.738936 },
-    { .note=100, .freq=2637.020455, .pot1=26860.45221, .pot2=2686.045221 },
-    { .note=101, .freq=2793.825851, .pot1=25324.82803, .pot2=2532.482803 },
-    { .note=102, .freq=2959.955382, .pot1=23875.3918,  .pot2=2387.53918  },
-    { .note=103, .freq=3135.963488, .pot1=22507.30619, .pot2=2250.730619 },
-    { .note=104, .freq=3322.437581, .pot1=21216.00531, .pot2=2121.600531 },
-    { .note=105, .freq=3520,        .pot1=19997.17959, .pot2=1999.717959 },
-    { .note=106, .freq=3729.310092, .pot1=18846.7613,  .pot2=1884.67613  },
-    { .note=107, .freq=3951.06641,  .pot1=17760.91102, .pot2=1776.091102 },
-    { .note=108, .freq=4186.009045, .pot1=16736.00484, .pot2=1673.600484 },
-    { .note=109, .freq=4434.922096, .pot1=15768.62222, .pot2=1576.862222 },
-    { .note=110, .freq=4698.636287, .pot1=14855.53462, .pot2=1485.553462 },
-    { .note=111, .freq=4978.03174,  .pot1=13993.69468, .pot2=1399.369468 },
-    { .note=112, .freq=5274.040911, .pot1=13180.22611, .pot2=1318.022611 },
-    { .note=113, .freq=5587.651703, .pot1=12412.41401, .pot2=1241.241401 },
-    { .note=114, .freq=5919.910763, .pot1=11687.6959,  .pot2=1168.76959  },
-    { .note=115, .freq=6271.926976, .pot1=11003.65309, .pot2=1100.365309 },
-    { .note=116, .freq=6644.875161, .pot1=10358.00266, .pot2=1035.800266 },
-    { .note=117, .freq=7040,        .pot1=9748.589794, .pot2=974.8589794 },
-    { .note=118, .freq=7458.620184, .pot1=9173.380648, .pot2=917.3380648 },
-    { .note=119, .freq=7902.13282,  .pot1=8630.45551,  .pot2=863.045551  },
-    { .note=120, .freq=8372.01809,  .pot1=8118.002419, .pot2=811.8002419 },
-    { .note=121, .freq=8869.844191, .pot1=7634.31111,  .pot2=763.431111  },
-    { .note=122, .freq=9397.272573, .pot1=7177.767308, .pot2=717.7767308 },
-    { .note=123, .freq=9956.063479, .pot1=6746.847341, .pot2=674.6847341 },
-    { .note=124, .freq=10548.08182, .pot1=6340.113053, .pot2=634.0113053 },
-    { .note=125, .freq=11175.30341, .pot1=5956.207007, .pot2=595.6207007 },
-    { .note=126, .freq=11839.82153, .pot1=5593.847951, .pot2=559.3847951 },
-    { .note=127, .freq=12543.85395, .pot1=5251.826546, .pot2=525.1826546 }
-};
+        /* round the whole period rather than each half of it */
+        period = lround (high + low);
+        n->high_time_astable = lround (high);
+        if (n->high_time_astable < 1)
+            n->high_time_astable = 1;
+        if (period <= n->high_time_astable)
+            period = n->high_time_astable + 1;
+        n->low_time_astable = period - n->high_time_astable;
+        n->high_time_monostable = lround (MONOSTABLE_TIME(n->pot2) * srate);
+    }
+}
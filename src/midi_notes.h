@@ -20,11 +20,35 @@
 #ifndef JPC_MIDI_NOTES_H_
 #define JPC_MIDI_NOTES_H_
 
+#include <stdint.h>
+
+#define MIDI_NOTES_COUNT 128
+
+#define MAX_POT_VALUE 470000
+
+/* 555 timings in seconds, for potentiometer values in ohms */
+#define ASTABLE_HIGH_TIME(_pot1) (0.693*((_pot1) + 1000.0)*.01E-6)
+#define ASTABLE_LOW_TIME(_pot1)  (0.693*(_pot1)*.01E-6)
+#define MONOSTABLE_TIME(_pot2)   (0.693*(_pot2)*.1E-6)
+
+/* freq is 0 for the keys not mapped to the scale. The timings are in
+   frames at the current sample rate. */
 extern struct midi_notes_t {
     unsigned int note;
     double       freq;
     double       pot1;
     double       pot2;
-} midi_notes[];
+    int          high_time_astable;
+    int           low_time_astable;
+    int          high_time_monostable;
+} midi_notes[MIDI_NOTES_COUNT];
+
+/* Compute the note table from optional scala .scl and .kbm files, and a
+   reference frequency overriding the one of the mapping if not 0. */
+int  midi_notes_init (double reference_freq,
+                      const char *scale_path,
+                      const char *keymap_path);
+
+void midi_notes_update_srate (uint32_t srate);
 
 #endif
@@ -0,0 +1,115 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+#define STACK_PREFAULT_SIZE (64 * 1024)
+
+int rt_lock_memory (void) {
+    if (mlockall (MCL_CURRENT | MCL_FUTURE)) {
+        fprintf (stderr, "Cannot lock memory: %s\n", strerror (errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+void rt_prefault (void *addr, size_t len) {
+    volatile unsigned char *p = (volatile unsigned char *)addr;
+    long page_size = sysconf (_SC_PAGESIZE);
+
+    if (len == 0)
+        return;
+
+    /* read and write back, so that copy-on-write pages get their own
+       copy now and not on the first write from the audio thread */
+    for (size_t i = 0; i < len; i += page_size)
+        p[i] = p[i];
+    p[len - 1] = p[len - 1];
+}
+
+void rt_prefault_stack (void) {
+    volatile unsigned char stack[STACK_PREFAULT_SIZE];
+
+    for (size_t i = 0; i < STACK_PREFAULT_SIZE; i += 256)
+        stack[i] = 0;
+
+    (void)stack;
+}
+
+int rt_set_priority (int priority) {
+    struct sched_param param;
+    int err;
+
+    memset (&param, 0, sizeof (param));
+    param.sched_priority = priority;
+
+    if ((err = pthread_setschedparam (pthread_self (), SCHED_FIFO, &param))) {
+        fprintf (stderr, "Cannot set real-time priority %d: %s\n",
+                 priority, strerror (err));
+        return -1;
+    }
+
+    return 0;
+}
+
+int rt_check_cpu (int cpu) {
+    long count = sysconf (_SC_NPROCESSORS_CONF);
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE || (count > 0 && cpu >= count)) {
+        fprintf (stderr, "No such cpu: %d\n", cpu);
+        return -1;
+    }
+
+    /* the affinity can only be narrowed down, e.g. inside a cpuset */
+    if (sched_getaffinity (0, sizeof (set), &set) == 0
+        && ! CPU_ISSET (cpu, &set)) {
+        fprintf (stderr, "Cpu %d is not allowed for this process\n", cpu);
+        return -1;
+    }
+
+    return 0;
+}
+
+int rt_pin_thread (int cpu) {
+    cpu_set_t set;
+    int err;
+
+    CPU_ZERO (&set);
+    CPU_SET (cpu, &set);
+
+    if ((err = pthread_setaffinity_np (pthread_self (), sizeof (set), &set))) {
+        fprintf (stderr, "Cannot pin thread to cpu %d: %s\n",
+                 cpu, strerror (err));
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPC_RT_H_
+#define JPC_RT_H_
+
+#include <stddef.h>
+
+#define CACHE_LINE_SIZE 64
+#define CACHE_ALIGNED __attribute__ ((aligned (CACHE_LINE_SIZE)))
+
+/* Lock current and future pages of the process into memory. */
+int  rt_lock_memory (void);
+
+/* Touch every page of a writable memory area. */
+void rt_prefault (void *addr, size_t len);
+
+/* Touch the stack of the calling thread, to be called from the audio
+   thread before it starts processing. */
+void rt_prefault_stack (void);
+
+/* Give the calling thread a SCHED_FIFO priority, for the backends
+   running their own audio thread. */
+int  rt_set_priority (int priority);
+
+/* Check that a cpu exists and that the process may run on it. */
+int  rt_check_cpu (int cpu);
+
+/* Pin the calling thread to the given cpu. */
+int  rt_pin_thread (int cpu);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scala.h"
+
+#define LINE_SIZE 512
+
+/* Floor division, as keys below the middle note go down the octaves. */
+#define FLOOR_DIV(_a,_b) \
+    ((_a) >= 0 ? (_a) / (_b) : -((-(_a) + (_b) - 1) / (_b)))
+#define FLOOR_MOD(_a,_b) ((_a) - FLOOR_DIV(_a,_b) * (_b))
+
+/* Next line which is not a comment, with its blanks stripped. */
+static char *read_line (FILE *file, char *line) {
+    while (fgets (line, LINE_SIZE, file)) {
+        char *start = line;
+        char *end;
+
+        if (line[0] == '!')
+            continue;
+
+        while (isspace ((unsigned char)*start))
+            start++;
+
+        end = start + strlen (start);
+        while (end > start && isspace ((unsigned char)end[-1]))
+            *--end = '\0';
+
+        return start;
+    }
+
+    return NULL;
+}
+
+static char *read_value (FILE *file, char *line) {
+    char *value;
+
+    while ((value = read_line (file, line)) && *value == '\0');
+
+    return value;
+}
+
+static int parse_int (const char *value, int *i) {
+    char *end;
+    long l;
+
+    if (value == NULL)
+        return -1;
+
+    l = strtol (value, &end, 10);
+    if (end == value || (*end != '\0' && ! isspace ((unsigned char)*end)))
+        return -1;
+
+    *i = l;
+
+    return 0;
+}
+
+static int parse_double (const char *value, double *d) {
+    char *end;
+
+    if (value == NULL)
+        return -1;
+
+    *d = strtod (value, &end);
+    if (end == value || (*end != '\0' && ! isspace ((unsigned char)*end))
+        || ! isfinite (*d))
+        return -1;
+
+    return 0;
+}
+
+/* A pitch is in cents if it has a dot, else a ratio or an integer. */
+static int parse_pitch (const char *value, double *cents) {
+    char *end;
+
+    if (value == NULL)
+        return -1;
+
+    if (memchr (value, '.', strcspn (value, " \t"))) {
+        *cents = strtod (value, &end);
+        if (end == value || ! isfinite (*cents))
+            return -1;
+    } else {
+        long num = strtol (value, &end, 10);
+        long den = 1;
+
+        if (end == value)
+            return -1;
+        if (*end == '/')
+            den = strtol (end + 1, &end, 10);
+        if (num <= 0 || den <= 0)
+            return -1;
+
+        *cents = 1200.0 * log2 ((double)num / den);
+    }
+
+    return 0;
+}
+
+void scala_default_scale (struct scala_scale *scale) {
+    scale->count = 12;
+    for (int i = 0; i <= 12; i++)
+        scale->cents[i] = 100.0 * i;
+}
+
+void scala_default_keymap (struct scala_keymap *keymap) {
+    keymap->size = 0;
+    keymap->first = 0;
+    keymap->last = 127;
+    keymap->middle = 60;
+    keymap->reference = 69;
+    keymap->freq = 440.0;
+    keymap->octave_degree = 0;
+}
+
+int scala_load_scale (const char *path, struct scala_scale *scale) {
+    char line[LINE_SIZE];
+    FILE *file;
+    int count;
+
+    if ((file = fopen (path, "r")) == NULL) {
+        fprintf (stderr, "Cannot open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+
+    /* the description may be empty */
+    if (read_line (file, line) == NULL
+        || parse_int (read_value (file, line), &count)
+        || count < 1
+        || count > SCALA_MAX_NOTES) {
+        fprintf (stderr, "%s: invalid scale\n", path);
+        fclose (file);
+        return -1;
+    }
+
+    scale->count = count;
+    scale->cents[0] = 0.0;
+    for (int i = 1; i <= count; i++) {
+        if (parse_pitch (read_value (file, line), &scale->cents[i])) {
+            fprintf (stderr, "%s: invalid pitch %d\n", path, i);
+            fclose (file);
+            return -1;
+        }
+    }
+
+    fclose (file);
+
+    return 0;
+}
+
+int scala_load_keymap (const char *path, struct scala_keymap *keymap) {
+    char line[LINE_SIZE];
+    FILE *file;
+    char *value;
+
+    if ((file = fopen (path, "r")) == NULL) {
+        fprintf (stderr, "Cannot open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+
+    if (parse_int (read_value (file, line), &keymap->size)
+        || parse_int (read_value (file, line), &keymap->first)
+        || parse_int (read_value (file, line), &keymap->last)
+        || parse_int (read_value (file, line), &keymap->middle)
+        || parse_int (read_value (file, line), &keymap->reference)
+        || parse_double (read_value (file, line), &keymap->freq)
+        || keymap->freq <= 0.0
+        || parse_int (read_value (file, line), &keymap->octave_degree)
+        || keymap->size < 0
+        || keymap->size > SCALA_MAX_KEYS) {
+        fprintf (stderr, "%s: invalid keyboard mapping\n", path);
+        fclose (file);
+        return -1;
+    }
+
+    /* missing entries are unmapped */
+    for (int i = 0; i < keymap->size; i++) {
+        if ((value = read_value (file, line)) == NULL
+            || parse_int (value, &keymap->map[i]))
+            keymap->map[i] = -1;
+    }
+
+    fclose (file);
+
+    /* the frequency of every key is relative to the reference one */
+    if (keymap->size > 0
+        && keymap->map[FLOOR_MOD(keymap->reference - keymap->middle,
+                                 keymap->size)] < 0) {
+        fprintf (stderr, "%s: reference key %d is not mapped\n",
+                 path, keymap->reference);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Scale degree of a note, fails if it is not mapped. */
+static int note_degree (const struct scala_scale *scale,
+                        const struct scala_keymap *keymap,
+                        int note,
+                        int *degree) {
+    int offset = note - keymap->middle;
+    int octave_degree = keymap->octave_degree > 0
+        ? keymap->octave_degree
+        : scale->count;
+    int mapped;
+
+    if (keymap->size == 0) {
+        *degree = offset;
+        return 0;
+    }
+
+    if ((mapped = keymap->map[FLOOR_MOD(offset, keymap->size)]) < 0)
+        return -1;
+
+    *degree = FLOOR_DIV(offset, keymap->size) * octave_degree + mapped;
+
+    return 0;
+}
+
+static double degree_cents (const struct scala_scale *scale, int degree) {
+    return FLOOR_DIV(degree, scale->count) * scale->cents[scale->count]
+        + scale->cents[FLOOR_MOD(degree, scale->count)];
+}
+
+double scala_frequency (const struct scala_scale *scale,
+                        const struct scala_keymap *keymap,
+                        int note) {
+    int degree;
+    int reference_degree;
+
+    if (note < keymap->first || note > keymap->last
+        || note_degree (scale, keymap, note, &degree)
+        || note_degree (scale, keymap, keymap->reference,
+                        &reference_degree))
+        return 0.0;
+
+    return keymap->freq * pow (2.0, (degree_cents (scale, degree)
+                                     - degree_cents (scale, reference_degree))
+                                    / 1200.0);
+}
+
+#undef FLOOR_MOD
+#undef FLOOR_DIV
@@ -0,0 +1,61 @@
+/*
+    jackpunkconsole
+
+    Copyright (C) 2015 Stéphane Witryk <s.witryk@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPC_SCALA_H_
+#define JPC_SCALA_H_
+
+/* Scala tuning files, see http://www.huygens-fokker.org/scala/ */
+
+#define SCALA_MAX_NOTES 1024
+#define SCALA_MAX_KEYS  128
+
+/* A .scl scale, cents[0] is the unison and cents[count] the period. */
+struct scala_scale {
+    int    count;
+    double cents[SCALA_MAX_NOTES + 1];
+};
+
+/* A .kbm keyboard mapping, unmapped keys are -1 in map. A size of 0 maps
+   the keys linearly to the scale degrees. */
+struct scala_keymap {
+    int    size;
+    int    first;
+    int    last;
+    int    middle;
+    int    reference;
+    double freq;
+    int    octave_degree;
+    int    map[SCALA_MAX_KEYS];
+};
+
+/* 12 tone equal temperament. */
+void scala_default_scale (struct scala_scale *scale);
+
+/* Linear mapping, middle C on degree 0 and A4 at 440Hz. */
+void scala_default_keymap (struct scala_keymap *keymap);
+
+int  scala_load_scale (const char *path, struct scala_scale *scale);
+int  scala_load_keymap (const char *path, struct scala_keymap *keymap);
+
+/* Frequency of a midi note, or 0 if the note is not mapped. */
+double scala_frequency (const struct scala_scale *scale,
+                        const struct scala_keymap *keymap,
+                        int note);
+
+#endif